@@ -0,0 +1,124 @@
+#ifdef ENABLE_ICS_OVERRIDE
+#include <Arduino.h>
+
+#include <ESP8266WiFi.h>
+#include <ESP8266HTTPClient.h>
+
+#include "config.h"
+#include "calendar.h"
+#include "crash_report.h"
+#include "ics.h"
+
+#define ICS_FETCH_TIMEOUT 10000 // ms
+
+static IcsParser parser;
+static IcsWindow overrides[ICS_MAX_OVERRIDES];
+static size_t override_count = 0;
+
+// Validators from the last successful fetch, sent back to the server
+static String etag;
+static String last_modified;
+
+/*
+ * The list only holds events inside the lookahead window at the time of the
+ * last full download. An unchanged feed still has events that have since
+ * moved into the window (or were dropped when the list was full), so after
+ * ICS_WINDOW_MAX_AGE the feed is downloaded again without validators.
+ */
+#define ICS_WINDOW_MAX_AGE 86400 // seconds
+static time_t window_from = 0;
+
+static unsigned long last_fetch = 0;
+static bool fetched_once = false;
+
+static void fetchCalendar(time_t now) {
+  WiFiClient client;
+  HTTPClient http;
+
+  // HTTP/1.0 so the body is never chunked and can be parsed straight off the stream
+  http.useHTTP10(true);
+  if (!http.begin(client, ICS_URL)) {
+    logRecord("Calendar: invalid URL\n");
+    return;
+  }
+  const char *headers[] = { "ETag", "Last-Modified" };
+  http.collectHeaders(headers, 2);
+  bool window_current = window_from && now - window_from < ICS_WINDOW_MAX_AGE;
+  if (window_current && etag.length()) {
+    http.addHeader("If-None-Match", etag);
+  }
+  if (window_current && last_modified.length()) {
+    http.addHeader("If-Modified-Since", last_modified);
+  }
+
+  int code = http.GET();
+  if (code == HTTP_CODE_NOT_MODIFIED) {
+    logRecord("Calendar: not modified\n");
+    http.end();
+    return;
+  }
+  if (code != HTTP_CODE_OK) {
+    logRecord("Calendar: fetch failed (%d)\n", code);
+    http.end();
+    return;
+  }
+
+  parser.begin(now, now + ICS_LOOKAHEAD_DAYS * 86400L);
+  int remaining = http.getSize(); // -1 if the server did not send a length
+  WiFiClient *stream = http.getStreamPtr();
+  uint8_t buf[128];
+  unsigned long start = millis();
+  bool timed_out = false;
+  while ((http.connected() || stream->available()) && remaining != 0) {
+    if (millis() - start >= ICS_FETCH_TIMEOUT) {
+      timed_out = true;
+      break;
+    }
+    size_t avail = stream->available();
+    if (!avail) {
+      delay(1);
+      continue;
+    }
+    int n = stream->readBytes(buf, avail < sizeof(buf) ? avail : sizeof(buf));
+    for (int i = 0; i < n; i++) {
+      parser.feed(buf[i]);
+    }
+    if (remaining > 0) {
+      remaining -= n;
+    }
+  }
+  parser.feed('\n'); // In case the last line has no line ending
+
+  // Without Content-Length, only END:VCALENDAR shows the whole feed arrived
+  if (timed_out || remaining > 0 || !parser.complete()) {
+    // Keep the old list and validators rather than use a partial feed
+    logRecord("Calendar: download incomplete\n");
+    http.end();
+    return;
+  }
+
+  override_count = parser.finish(overrides, ICS_MAX_OVERRIDES);
+  window_from = now;
+  etag = http.header("ETag");
+  last_modified = http.header("Last-Modified");
+  http.end();
+
+  logRecord("Calendar: %u override windows, %u events dropped\n", (unsigned) override_count, (unsigned) parser.dropped());
+}
+
+void calendarLoop() {
+  if (WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  if (fetched_once && millis() - last_fetch < ICS_FETCH_INTERVAL_MIN * 60000UL) {
+    return;
+  }
+  last_fetch = millis();
+  fetched_once = true;
+  fetchCalendar(time(nullptr));
+}
+
+bool calendarOverrideActive(time_t t) {
+  return icsWindowActive(overrides, override_count, t);
+}
+#endif
@@ -0,0 +1,13 @@
+/*
+ * Event calendar overrides
+ *
+ * Periodically fetches an iCalendar feed (ICS_URL in config.h) and keeps
+ * the lights on during any upcoming event. Fetches are conditional, so an
+ * unchanged feed is not downloaded again.
+ */
+#pragma once
+
+#include <time.h>
+
+void calendarLoop();
+bool calendarOverrideActive(time_t t);
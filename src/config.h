@@ -14,4 +14,80 @@
 
 // Timezone offsets from UTC in hours, for both Standard and Daylight Savings Time
 #define TZ_OFFSET       -6
-#define DST_OFFSET      -5
\ No newline at end of file
+#define DST_OFFSET      -5
+
+/*
+ * Secure telemetry, only used when compiled with -DENABLE_SECURE_TELEMETRY
+ */
+
+#define TELEMETRY_HOST          "telemetry.local"
+#define TELEMETRY_PORT          443
+#define TELEMETRY_PATH          "/dusk2dawn/status"
+
+// SHA-1 fingerprint of the server certificate
+#define TELEMETRY_FINGERPRINT   "00:00:00:00:00:00:00:00:00:00:00:00:00:00:00:00:00:00:00:00"
+
+// Minutes between telemetry reports
+#define TELEMETRY_INTERVAL_MIN  15
+
+// TLS buffer sizes in bytes, only used if the server supports max fragment length negotiation
+#define TLS_RX_BUFFER_SIZE      1024
+#define TLS_TX_BUFFER_SIZE      512
+
+
+/*
+ * Crash reports, saved in RTC memory (384 bytes available)
+ */
+
+// Number of code addresses kept from the stack
+#define CRASH_STACK_DEPTH       16
+
+// Number and length of the most recent log records kept
+#define CRASH_LOG_LINES         4
+#define CRASH_LOG_LINE_LEN      48
+
+
+/*
+ * Local horizon, only used when compiled with -DENABLE_HORIZON_MASK
+ */
+
+// Horizon elevation in degrees for each azimuth sector. Sectors are equal
+// width, the first starts at north and they go clockwise (east is next).
+#define HORIZON_SECTORS         8
+#define HORIZON_PROFILE         { 0, 0, 0, 0, 0, 0, 0, 0 }
+
+// Search resolution: 0 for coarse (about 1 minute), 1 for fine (a few seconds, more computation).
+// Weather dependent refraction limits real accuracy to about a minute either way.
+#define HORIZON_FINE_RESOLUTION 0
+
+
+/*
+ * GPS, only used when compiled with -DENABLE_GPS
+ */
+
+#define GPS_RX_PIN              14 // GPIO14, GPS TX connects here
+#define GPS_PPS_PIN             13 // GPIO13, comment out if PPS is not connected
+#define GPS_BAUD                9600
+
+// Minutes between setting the clock from GPS
+#define GPS_TIME_SYNC_INTERVAL_MIN 10
+
+// Recalculate sunrise/sunset when the position moves more than this
+#define GPS_MOVE_THRESHOLD_KM   5.0
+
+
+/*
+ * Event calendar, only used when compiled with -DENABLE_ICS_OVERRIDE
+ * Lights stay on during any event in the feed.
+ */
+
+#define ICS_URL                 "http://192.168.1.10/events.ics"
+
+// Minutes between checking the feed for changes
+#define ICS_FETCH_INTERVAL_MIN  30
+
+// Only events starting within this many days are kept
+#define ICS_LOOKAHEAD_DAYS      14
+
+// Maximum number of upcoming events kept
+#define ICS_MAX_OVERRIDES       32
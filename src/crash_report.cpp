@@ -0,0 +1,207 @@
+#include <Arduino.h>
+
+#include <LittleFS.h>
+#include <coredecls.h>
+#include <user_interface.h>
+
+#include "config.h"
+#include "crash_report.h"
+
+#define CRASH_MAGIC        0x44324443 // "D2DC"
+#define CRASH_JOURNAL_FILE "/crash.log"
+#define CRASH_JOURNAL_OLD  "/crash.old"
+#define CRASH_JOURNAL_MAX  8192
+
+/*
+ * The first 128 bytes (32 blocks) of RTC user memory are used by eboot
+ * for OTA, so the record starts after them. 384 bytes remain.
+ */
+#define CRASH_RTC_OFFSET   32
+#define CRASH_RTC_SIZE     384
+
+struct CrashRecord {
+  uint32_t magic;
+  uint32_t reason;
+  uint32_t exccause;
+  uint32_t epc1;
+  uint32_t excvaddr;
+  uint32_t depc;
+  uint32_t stage;
+  uint32_t stack_count;
+  uint32_t stack[CRASH_STACK_DEPTH];
+  uint32_t log_next;
+  char log[CRASH_LOG_LINES][CRASH_LOG_LINE_LEN];
+  uint32_t crc;
+};
+
+// The loop stage is kept in its own block so that it survives a hardware watchdog reset
+#define CRASH_STAGE_OFFSET (CRASH_RTC_OFFSET + sizeof(CrashRecord) / 4)
+
+static_assert(sizeof(CrashRecord) % 4 == 0, "CrashRecord must be a whole number of RTC blocks");
+static_assert(sizeof(CrashRecord) + 4 <= CRASH_RTC_SIZE, "CrashRecord does not fit in RTC user memory");
+
+static char log_ring[CRASH_LOG_LINES][CRASH_LOG_LINE_LEN];
+static uint32_t log_next = 0;
+static volatile uint32_t current_stage = 0;
+
+static const char *stageName(uint32_t stage) {
+  switch (stage) {
+    case STAGE_SETUP:     return "setup";
+    case STAGE_WIFI:      return "wifi";
+    case STAGE_WAIT_NTP:  return "wait_ntp";
+    case STAGE_CALC_SUN:  return "calc_sun";
+    case STAGE_FADE:      return "fade";
+    case STAGE_TELEMETRY: return "telemetry";
+    case STAGE_IDLE:      return "idle";
+    case STAGE_CALENDAR:  return "calendar";
+    default:              return "unknown";
+  }
+}
+
+static const char *reasonName(uint32_t reason) {
+  switch (reason) {
+    case REASON_DEFAULT_RST:      return "power on";
+    case REASON_WDT_RST:          return "hardware watchdog";
+    case REASON_EXCEPTION_RST:    return "exception";
+    case REASON_SOFT_WDT_RST:     return "software watchdog";
+    case REASON_SOFT_RESTART:     return "software restart";
+    case REASON_DEEP_SLEEP_AWAKE: return "deep sleep wake";
+    case REASON_EXT_SYS_RST:      return "external reset";
+    default:                      return "unknown";
+  }
+}
+
+/*
+ * Print to the serial port and keep the line in a small ring buffer
+ * so the last few records can be saved if we crash.
+ */
+void logRecord(const char *fmt, ...) {
+  char *line = log_ring[log_next % CRASH_LOG_LINES];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, CRASH_LOG_LINE_LEN, fmt, args);
+  va_end(args);
+  log_next++;
+
+  // Print the full message, the ring buffer copy may be truncated
+  va_start(args, fmt);
+  char buf[128];
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  Serial.print(buf);
+}
+
+void crashSetStage(LoopStage stage) {
+  uint32_t s = stage;
+  current_stage = s;
+  ESP.rtcUserMemoryWrite(CRASH_STAGE_OFFSET, &s, sizeof(s));
+}
+
+/*
+ * Called by the core on an exception or soft watchdog reset, just before restarting.
+ * Keep this short, the system is in an unknown state.
+ */
+extern "C" void custom_crash_callback(struct rst_info *rst_info, uint32_t stack, uint32_t stack_end) {
+  static CrashRecord rec;
+  rec.magic = CRASH_MAGIC;
+  rec.reason = rst_info->reason;
+  rec.exccause = rst_info->exccause;
+  rec.epc1 = rst_info->epc1;
+  rec.excvaddr = rst_info->excvaddr;
+  rec.depc = rst_info->depc;
+  rec.stage = current_stage;
+
+  // Keep only words that look like code addresses (IRAM or flash)
+  rec.stack_count = 0;
+  for (uint32_t p = stack; p < stack_end && rec.stack_count < CRASH_STACK_DEPTH; p += 4) {
+    uint32_t v = *(uint32_t *) p;
+    if ((v >= 0x40100000 && v < 0x40108000) || (v >= 0x40200000 && v < 0x40300000)) {
+      rec.stack[rec.stack_count++] = v;
+    }
+  }
+
+  rec.log_next = log_next;
+  memcpy(rec.log, log_ring, sizeof(rec.log));
+  rec.crc = crc32(&rec, offsetof(CrashRecord, crc));
+  ESP.rtcUserMemoryWrite(CRASH_RTC_OFFSET, (uint32_t *) &rec, sizeof(rec));
+}
+
+/*
+ * Write the report to the given output, used for both serial and the journal
+ */
+static void printReport(Print &out, const rst_info *info, const CrashRecord *rec, uint32_t stage) {
+  out.printf("Reset reason: %s (%u)\n", reasonName(info->reason), info->reason);
+  out.printf("Loop stage: %s\n", stageName(rec ? rec->stage : stage));
+  if (!rec) {
+    return;
+  }
+  out.printf("Exception %u epc1=0x%08x excvaddr=0x%08x depc=0x%08x\n", rec->exccause, rec->epc1, rec->excvaddr, rec->depc);
+  out.print("Stack:");
+  for (uint32_t i = 0; i < rec->stack_count; i++) {
+    out.printf(" 0x%08x", rec->stack[i]);
+  }
+  out.println();
+
+  // Oldest log record first
+  uint32_t count = rec->log_next < CRASH_LOG_LINES ? rec->log_next : CRASH_LOG_LINES;
+  for (uint32_t i = rec->log_next - count; i < rec->log_next; i++) {
+    char line[CRASH_LOG_LINE_LEN];
+    memcpy(line, rec->log[i % CRASH_LOG_LINES], CRASH_LOG_LINE_LEN);
+    line[CRASH_LOG_LINE_LEN - 1] = '\0';
+    out.printf("Log: %s", line);
+    if (line[0] && line[strlen(line) - 1] != '\n') {
+      out.println();
+    }
+  }
+}
+
+static void appendJournal(const rst_info *info, const CrashRecord *rec, uint32_t stage) {
+  if (!LittleFS.begin()) {
+    Serial.println("LittleFS mount failed, crash report not saved");
+    return;
+  }
+  File f = LittleFS.open(CRASH_JOURNAL_FILE, "a");
+  if (!f) {
+    Serial.println("Unable to open crash journal");
+    return;
+  }
+  if (f.size() > CRASH_JOURNAL_MAX) {
+    f.close();
+    LittleFS.remove(CRASH_JOURNAL_OLD);
+    LittleFS.rename(CRASH_JOURNAL_FILE, CRASH_JOURNAL_OLD);
+    f = LittleFS.open(CRASH_JOURNAL_FILE, "a");
+    if (!f) {
+      return;
+    }
+  }
+  f.println("=== Crash report ===");
+  printReport(f, info, rec, stage);
+  f.close();
+}
+
+void crashReportSetup() {
+  const rst_info *info = ESP.getResetInfoPtr();
+
+  static CrashRecord rec;
+  ESP.rtcUserMemoryRead(CRASH_RTC_OFFSET, (uint32_t *) &rec, sizeof(rec));
+  bool valid = rec.magic == CRASH_MAGIC && rec.crc == crc32(&rec, offsetof(CrashRecord, crc));
+
+  uint32_t stage = 0;
+  ESP.rtcUserMemoryRead(CRASH_STAGE_OFFSET, &stage, sizeof(stage));
+
+  bool crashed = info->reason == REASON_WDT_RST || info->reason == REASON_EXCEPTION_RST || info->reason == REASON_SOFT_WDT_RST;
+  if (crashed) {
+    Serial.println("=== Crash report ===");
+    printReport(Serial, info, valid ? &rec : nullptr, stage);
+    appendJournal(info, valid ? &rec : nullptr, stage);
+  } else {
+    Serial.printf("Reset reason: %s\n", reasonName(info->reason));
+  }
+
+  // Don't report the same crash twice
+  if (valid) {
+    rec.magic = 0;
+    ESP.rtcUserMemoryWrite(CRASH_RTC_OFFSET, (uint32_t *) &rec, sizeof(rec.magic));
+  }
+  crashSetStage(STAGE_SETUP);
+}
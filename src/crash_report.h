@@ -0,0 +1,28 @@
+/*
+ * Crash and watchdog post-mortem capture
+ *
+ * On an exception or soft watchdog reset, the reset cause, registers,
+ * a short stack trace, the last few log records and the loop stage that
+ * was running are saved to RTC memory. The next boot prints them and
+ * appends them to a journal file on LittleFS.
+ *
+ * Use tools/decode_crash.py to resolve the addresses against the ELF.
+ */
+#pragma once
+
+// Stored as a number in RTC memory and read back by the next firmware,
+// so only add new stages at the end
+enum LoopStage {
+  STAGE_SETUP = 1,
+  STAGE_WIFI,
+  STAGE_WAIT_NTP,
+  STAGE_CALC_SUN,
+  STAGE_FADE,
+  STAGE_TELEMETRY,
+  STAGE_IDLE,
+  STAGE_CALENDAR,
+};
+
+void crashReportSetup();
+void crashSetStage(LoopStage stage);
+void logRecord(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
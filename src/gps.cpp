@@ -0,0 +1,113 @@
+#ifdef ENABLE_GPS
+#include <Arduino.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include <SoftwareSerial.h>
+
+#include "config.h"
+#include "crash_report.h"
+#include "gps.h"
+#include "nmea.h"
+
+static SoftwareSerial gps_serial;
+static NmeaParser nmea;
+
+static volatile uint32_t pps_micros = 0;
+static volatile bool pps_seen = false;
+static unsigned long last_time_sync = 0;
+static bool time_synced = false;
+
+#ifdef GPS_PPS_PIN
+// Record when the second started, the RMC sentence that follows gives its time
+void IRAM_ATTR handlePps() {
+  pps_micros = micros();
+  pps_seen = true;
+}
+#endif
+
+void gpsSetup() {
+  gps_serial.begin(GPS_BAUD, SWSERIAL_8N1, GPS_RX_PIN, -1, false, 256);
+#ifdef GPS_PPS_PIN
+  pinMode(GPS_PPS_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(GPS_PPS_PIN), handlePps, RISING);
+#endif
+}
+
+/*
+ * The rest of the loop (fading, TLS, calendar fetch) can block for seconds
+ * while bytes pile up in the serial buffer. If we have not polled for longer
+ * than this, whatever is buffered is too old to set the clock from.
+ */
+#define GPS_STALE_MS 100
+
+static unsigned long last_poll = 0;
+
+/*
+ * rmc_micros is when the RMC sentence finished arriving. With PPS, the
+ * sentence gives the time of the pulse just before it. Without PPS, the
+ * sentence is only roughly aligned, so its fractional seconds are used.
+ */
+static void syncTime(const NmeaFix &fix, uint32_t rmc_micros) {
+  struct timeval tv;
+  uint32_t elapsed_us;
+
+  noInterrupts();
+  bool have_pps = pps_seen;
+  uint32_t edge = pps_micros;
+  interrupts();
+  have_pps = have_pps && (int32_t) (rmc_micros - edge) >= 0 && rmc_micros - edge < 1000000;
+  if (have_pps) {
+    elapsed_us = micros() - edge;
+  } else {
+    elapsed_us = fix.centiseconds * 10000UL + (micros() - rmc_micros);
+  }
+
+  tv.tv_sec = fix.utc + elapsed_us / 1000000;
+  tv.tv_usec = elapsed_us % 1000000;
+  settimeofday(&tv, nullptr);
+  logRecord("Time set from GPS%s\n", have_pps ? " (PPS)" : "");
+}
+
+void gpsLoop() {
+  if (gps_serial.overflow() || millis() - last_poll > GPS_STALE_MS) {
+    while (gps_serial.available()) {
+      gps_serial.read();
+    }
+    nmea.reset();
+  }
+  last_poll = millis();
+
+  while (gps_serial.available()) {
+    NmeaSentence s = nmea.feed(gps_serial.read());
+    if (s != NMEA_RMC) {
+      continue;
+    }
+    uint32_t rmc_micros = micros();
+    const NmeaFix &fix = nmea.fix();
+    if (fix.time_valid && fix.position_valid &&
+        (!time_synced || millis() - last_time_sync >= GPS_TIME_SYNC_INTERVAL_MIN * 60000UL)) {
+      syncTime(fix, rmc_micros);
+      last_time_sync = millis();
+      time_synced = true;
+    }
+  }
+}
+
+bool gpsPositionMoved(double *latitude, double *longitude) {
+  const NmeaFix &fix = nmea.fix();
+  if (!fix.position_valid) {
+    return false;
+  }
+
+  // Equirectangular approximation is plenty for a threshold check
+  double dy = (fix.latitude - *latitude) * 110.57;
+  double dx = (fix.longitude - *longitude) * 111.32 * cos(fix.latitude * M_PI / 180.0);
+  if (sqrt(dx * dx + dy * dy) < GPS_MOVE_THRESHOLD_KM) {
+    return false;
+  }
+  *latitude = fix.latitude;
+  *longitude = fix.longitude;
+  return true;
+}
+#endif
@@ -0,0 +1,16 @@
+/*
+ * GPS time and position source
+ *
+ * Reads NMEA sentences from a GPS module on a software serial port and
+ * sets the system clock from them, aligned to the PPS pulse if one is
+ * connected. Used for mobile installations where the configured location
+ * is wrong and WiFi is rarely available.
+ */
+#pragma once
+
+void gpsSetup();
+void gpsLoop();
+
+// Returns true and updates latitude/longitude if the GPS position has moved
+// more than GPS_MOVE_THRESHOLD_KM from the values passed in.
+bool gpsPositionMoved(double *latitude, double *longitude);
@@ -0,0 +1,156 @@
+#ifdef ENABLE_HORIZON_MASK
+#include <Arduino.h>
+#include <math.h>
+
+#include "config.h"
+#include "crash_report.h"
+#include "horizon.h"
+
+/*
+ * The day is scanned in steps of HORIZON_SCAN_STEP seconds to find where the
+ * sun crosses the horizon, then each crossing is refined by bisection down
+ * to HORIZON_REFINE_STEP seconds. A smaller scan step catches shorter gaps
+ * between buildings.
+ */
+#if HORIZON_FINE_RESOLUTION
+#define HORIZON_SCAN_STEP   120
+#define HORIZON_REFINE_STEP 5
+#else
+#define HORIZON_SCAN_STEP   600
+#define HORIZON_REFINE_STEP 60
+#endif
+
+// Apparent radius of the sun, the top of the disc is what clears the horizon
+#define SUN_SEMI_DIAMETER   0.266
+
+static const float horizon_profile[] = HORIZON_PROFILE;
+static_assert(sizeof(horizon_profile) / sizeof(horizon_profile[0]) == HORIZON_SECTORS,
+              "HORIZON_PROFILE must have exactly HORIZON_SECTORS entries");
+
+// True elevation of the sun's centre at which it clears each sector, see horizonThreshold()
+static double horizon_threshold[HORIZON_SECTORS];
+static bool thresholds_ready = false;
+
+static double deg2rad(double d) { return d * M_PI / 180.0; }
+static double rad2deg(double r) { return r * 180.0 / M_PI; }
+
+/*
+ * Approximate solar position (elevation and azimuth in degrees, azimuth
+ * clockwise from north) for a UTC time, good to about 0.01 degree.
+ */
+static void solarPosition(time_t t, double latitude, double longitude, double *elevation, double *azimuth) {
+  double n = (double) t / 86400.0 + 2440587.5 - 2451545.0; // days since J2000
+  double L = fmod(280.460 + 0.9856474 * n, 360.0);
+  double g = deg2rad(fmod(357.528 + 0.9856003 * n, 360.0));
+  double lambda = deg2rad(L + 1.915 * sin(g) + 0.020 * sin(2 * g));
+  double eps = deg2rad(23.439 - 0.0000004 * n);
+
+  double ra = atan2(cos(eps) * sin(lambda), cos(lambda));
+  double dec = asin(sin(eps) * sin(lambda));
+
+  double gmst = fmod(18.697374558 + 24.06570982441908 * n, 24.0);
+  double ha = deg2rad(gmst * 15.0 + longitude) - ra;
+  double lat = deg2rad(latitude);
+
+  *elevation = rad2deg(asin(sin(lat) * sin(dec) + cos(lat) * cos(dec) * cos(ha)));
+  double az = rad2deg(atan2(-sin(ha), tan(dec) * cos(lat) - sin(lat) * cos(ha)));
+  *azimuth = az < 0 ? az + 360.0 : az;
+}
+
+/*
+ * Atmospheric refraction in degrees for an apparent altitude in degrees
+ * (Bennett's formula). About 0.57 degree at a flat horizon, falling to
+ * 0.1 degree by 10 degrees up.
+ */
+static double refraction(double altitude) {
+  if (altitude < -1.0) {
+    altitude = -1.0; // Formula is only valid down to about here
+  }
+  return 1.0 / tan(deg2rad(altitude + 7.31 / (altitude + 4.4))) / 60.0;
+}
+
+/*
+ * The sun clears a sector when the top of its disc, lifted by refraction,
+ * reaches the horizon there. For a flat horizon this gives the usual 0.833
+ * degrees below, but refraction is much smaller against a raised horizon.
+ */
+static double horizonThreshold(double azimuth) {
+  if (!thresholds_ready) {
+    for (int i = 0; i < HORIZON_SECTORS; i++) {
+      horizon_threshold[i] = horizon_profile[i] - refraction(horizon_profile[i]) - SUN_SEMI_DIAMETER;
+    }
+    thresholds_ready = true;
+  }
+  int sector = (int) (azimuth * HORIZON_SECTORS / 360.0) % HORIZON_SECTORS;
+  return horizon_threshold[sector];
+}
+
+// Degrees the sun is above the local horizon, negative when hidden
+static double clearance(time_t t, double latitude, double longitude) {
+  double elevation, azimuth;
+  solarPosition(t, latitude, longitude, &elevation, &azimuth);
+  return elevation - horizonThreshold(azimuth);
+}
+
+// Narrow down a crossing between a and b, where clearance changes sign
+static time_t refine(time_t a, time_t b, double latitude, double longitude) {
+  bool a_visible = clearance(a, latitude, longitude) > 0;
+  while (b - a > HORIZON_REFINE_STEP) {
+    time_t mid = a + (b - a) / 2;
+    if ((clearance(mid, latitude, longitude) > 0) == a_visible) {
+      a = mid;
+    } else {
+      b = mid;
+    }
+  }
+  return b;
+}
+
+bool horizonCrossings(time_t day_start, double latitude, double longitude, time_t *rise, time_t *set) {
+  // Only recalculated once per day, or when the position changes
+  static time_t cached_day = 0;
+  static double cached_latitude, cached_longitude;
+  static time_t cached_rise, cached_set;
+  static bool cached_visible;
+
+  if (day_start != cached_day || latitude != cached_latitude || longitude != cached_longitude) {
+    unsigned long start = micros();
+    time_t first_rise = 0, last_set = 0;
+    time_t prev = day_start;
+    bool prev_visible = clearance(prev, latitude, longitude) > 0;
+    if (prev_visible) {
+      first_rise = day_start;
+    }
+
+    for (time_t t = day_start + HORIZON_SCAN_STEP; t <= day_start + 86400; t += HORIZON_SCAN_STEP) {
+      bool visible = clearance(t, latitude, longitude) > 0;
+      if (visible && !prev_visible && !first_rise) {
+        first_rise = refine(prev, t, latitude, longitude);
+      } else if (!visible && prev_visible) {
+        last_set = refine(prev, t, latitude, longitude);
+      }
+      prev = t;
+      prev_visible = visible;
+      yield();
+    }
+    if (prev_visible) {
+      last_set = day_start + 86400;
+    }
+
+    cached_day = day_start;
+    cached_latitude = latitude;
+    cached_longitude = longitude;
+    cached_visible = first_rise && last_set > first_rise;
+    cached_rise = first_rise;
+    cached_set = last_set;
+    logRecord("Horizon search took %lu us\n", micros() - start);
+  }
+
+  if (!cached_visible) {
+    return false;
+  }
+  *rise = cached_rise;
+  *set = cached_set;
+  return true;
+}
+#endif
@@ -0,0 +1,15 @@
+/*
+ * Local horizon mask
+ *
+ * Finds the times the sun actually clears the buildings or terrain
+ * around a fixture, using a horizon elevation profile per azimuth sector
+ * (HORIZON_PROFILE in config.h) instead of a flat horizon.
+ */
+#pragma once
+
+#include <time.h>
+
+// Find the first time the sun rises above and the last time it sets below the
+// local horizon during the day starting at day_start, for the given position.
+// Returns false if the sun never clears the horizon that day.
+bool horizonCrossings(time_t day_start, double latitude, double longitude, time_t *rise, time_t *set);
@@ -0,0 +1,247 @@
+#include <string.h>
+
+#include "ics.h"
+#include "time_util.h"
+
+static bool parseDigits(const char *s, int n, int *out) {
+  int v = 0;
+  for (int i = 0; i < n; i++) {
+    if (s[i] < '0' || s[i] > '9') {
+      return false;
+    }
+    v = v * 10 + (s[i] - '0');
+  }
+  *out = v;
+  return true;
+}
+
+/*
+ * Parse an iCalendar DATE or DATE-TIME value:
+ *   20261018           all day, local midnight
+ *   20261018T190000    local time (TZID is assumed to be the controller's timezone)
+ *   20261018T190000Z   UTC
+ */
+static bool parseDateTime(const char *value, time_t *out, bool *is_date) {
+  int year, month, day, hour = 0, min = 0, sec = 0;
+  if (!parseDigits(value, 4, &year) || !parseDigits(value + 4, 2, &month) || !parseDigits(value + 6, 2, &day)) {
+    return false;
+  }
+  *is_date = value[8] != 'T';
+  if (!*is_date &&
+      (!parseDigits(value + 9, 2, &hour) || !parseDigits(value + 11, 2, &min) || !parseDigits(value + 13, 2, &sec))) {
+    return false;
+  }
+
+  if (!*is_date && value[15] == 'Z') {
+    *out = makeUtcTime(year, month, day, hour, min, sec);
+  } else {
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = min;
+    t.tm_sec = sec;
+    t.tm_isdst = -1;
+    *out = mktime(&t);
+  }
+  return true;
+}
+
+/*
+ * Parse an iCalendar DURATION such as P1W, P1D, PT2H30M or P1DT12H.
+ * Negative durations are rejected since an event can't end before it starts.
+ */
+static bool parseDuration(const char *value, long *out) {
+  if (*value == '+') {
+    value++;
+  }
+  if (*value++ != 'P') {
+    return false;
+  }
+  long total = 0;
+  bool in_time = false;
+  bool any = false;
+  while (*value) {
+    if (*value == 'T') {
+      in_time = true;
+      value++;
+      continue;
+    }
+    long n = 0;
+    const char *digits = value;
+    while (*value >= '0' && *value <= '9') {
+      n = n * 10 + (*value++ - '0');
+    }
+    if (value == digits) {
+      return false;
+    }
+    switch (*value++) {
+      case 'W': total += n * 604800; break;
+      case 'D': total += n * 86400; break;
+      case 'H': if (!in_time) return false; total += n * 3600; break;
+      case 'M': if (!in_time) return false; total += n * 60; break;
+      case 'S': if (!in_time) return false; total += n; break;
+      default: return false;
+    }
+    any = true;
+  }
+  *out = total;
+  return any;
+}
+
+IcsParser::IcsParser() {
+  begin(0, 0);
+}
+
+void IcsParser::begin(time_t from, time_t to) {
+  _from = from;
+  _to = to;
+  _len = 0;
+  _overflow = false;
+  _complete = false;
+  _in_event = false;
+  _count = 0;
+  _dropped = 0;
+}
+
+void IcsParser::feed(char c) {
+  if (c == '\r') {
+    return;
+  }
+  if (c != '\n') {
+    if (_len < ICS_MAX_LINE) {
+      _line[_len++] = c;
+    } else {
+      _overflow = true;
+    }
+    return;
+  }
+
+  _line[_len] = '\0';
+  // Folded continuation lines start with whitespace, none of the properties we use need them
+  if (!_overflow && _len && _line[0] != ' ' && _line[0] != '\t') {
+    parseLine();
+  }
+  _len = 0;
+  _overflow = false;
+}
+
+void IcsParser::parseLine() {
+  if (strcmp(_line, "BEGIN:VEVENT") == 0) {
+    _in_event = true;
+    _cancelled = false;
+    _has_start = false;
+    _has_end = false;
+    _has_duration = false;
+    _sub_depth = 0;
+    return;
+  }
+  if (!_in_event) {
+    if (strcmp(_line, "END:VCALENDAR") == 0) {
+      _complete = true;
+    }
+    return;
+  }
+  // Skip components nested in the event, e.g. a VALARM has its own DURATION
+  if (strncmp(_line, "BEGIN:", 6) == 0) {
+    _sub_depth++;
+    return;
+  }
+  if (_sub_depth) {
+    if (strncmp(_line, "END:", 4) == 0) {
+      _sub_depth--;
+    }
+    return;
+  }
+  if (strcmp(_line, "END:VEVENT") == 0) {
+    _in_event = false;
+    if (!_has_start || _cancelled) {
+      return;
+    }
+    if (!_has_end && _has_duration) {
+      _end = _start + _duration;
+    } else if (!_has_end) {
+      // An all day event without DTEND lasts one day, otherwise it has no duration
+      _end = _start_is_date ? _start + 86400 : _start;
+    }
+    addEvent(_start, _end);
+    return;
+  }
+
+  // Property name ends at the first ';' (parameters) or ':' (value)
+  char *value = strchr(_line, ':');
+  if (!value) {
+    return;
+  }
+  *value++ = '\0';
+  char *params = strchr(_line, ';');
+  if (params) {
+    *params = '\0';
+  }
+
+  bool is_date;
+  if (strcmp(_line, "DTSTART") == 0) {
+    _has_start = parseDateTime(value, &_start, &_start_is_date);
+  } else if (strcmp(_line, "DTEND") == 0) {
+    _has_end = parseDateTime(value, &_end, &is_date);
+  } else if (strcmp(_line, "DURATION") == 0) {
+    _has_duration = parseDuration(value, &_duration);
+  } else if (strcmp(_line, "STATUS") == 0) {
+    _cancelled = strcmp(value, "CANCELLED") == 0;
+  }
+}
+
+/*
+ * Keep the events sorted by start time as they arrive. When the list is
+ * full the latest starting event is dropped, since it matters least.
+ */
+void IcsParser::addEvent(time_t start, time_t end) {
+  if (end <= start || end <= _from || start >= _to) {
+    return;
+  }
+  if (_count == ICS_MAX_OVERRIDES) {
+    _dropped++;
+    if (start >= _events[_count - 1].start) {
+      return;
+    }
+    _count--;
+  }
+  size_t i = _count;
+  while (i > 0 && _events[i - 1].start > start) {
+    _events[i] = _events[i - 1];
+    i--;
+  }
+  _events[i].start = start;
+  _events[i].end = end;
+  _count++;
+}
+
+size_t IcsParser::finish(IcsWindow *out, size_t max) {
+  size_t n = 0;
+  for (size_t i = 0; i < _count; i++) {
+    if (n && _events[i].start <= out[n - 1].end) {
+      // Overlaps or touches the previous window
+      if (_events[i].end > out[n - 1].end) {
+        out[n - 1].end = _events[i].end;
+      }
+    } else if (n < max) {
+      out[n++] = _events[i];
+    }
+  }
+  return n;
+}
+
+bool icsWindowActive(const IcsWindow *windows, size_t count, time_t t) {
+  // Find the last window starting at or before t
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (windows[mid].start <= t) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo > 0 && t < windows[lo - 1].end;
+}
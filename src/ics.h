@@ -0,0 +1,65 @@
+/*
+ * Streaming iCalendar (.ics) parser
+ *
+ * Characters are fed one at a time as they are downloaded, so the feed is
+ * never held in RAM. Only the DTSTART and DTEND (or DURATION) of each VEVENT
+ * are used.
+ * Events are collected into a fixed size list, which is then sorted and
+ * merged into non-overlapping windows that can be checked with a binary
+ * search. Has no Arduino dependencies so it can be run on a host.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+#include "config.h"
+
+#define ICS_MAX_LINE 96 // Longer lines are skipped, DTSTART/DTEND are much shorter
+
+struct IcsWindow {
+  time_t start;
+  time_t end;
+};
+
+class IcsParser {
+public:
+  IcsParser();
+
+  // Start a new feed. Only events that end after from and start before to are kept.
+  void begin(time_t from, time_t to);
+  void feed(char c);
+
+  // Sort and merge the collected events into out. Returns the number of windows.
+  size_t finish(IcsWindow *out, size_t max);
+
+  // Events that did not fit in ICS_MAX_OVERRIDES
+  size_t dropped() const { return _dropped; }
+
+  // True once END:VCALENDAR has been seen, i.e. the feed was not truncated
+  bool complete() const { return _complete; }
+
+private:
+  void parseLine();
+  void addEvent(time_t start, time_t end);
+
+  char _line[ICS_MAX_LINE + 1];
+  size_t _len;
+  bool _overflow;
+  bool _complete;
+
+  time_t _from, _to;
+  bool _in_event;
+  unsigned _sub_depth;
+  bool _cancelled;
+  time_t _start, _end;
+  long _duration;
+  bool _has_start, _has_end, _has_duration, _start_is_date;
+
+  IcsWindow _events[ICS_MAX_OVERRIDES];
+  size_t _count;
+  size_t _dropped;
+};
+
+// True if t falls inside one of the sorted, non-overlapping windows. O(log n).
+bool icsWindowActive(const IcsWindow *windows, size_t count, time_t t);
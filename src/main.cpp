@@ -13,6 +13,8 @@
     - Recalculates times at 5am each day
     - Uses GPIO12 (D6) to drive a MOSFET for LED control
     - PWM dimming to 75% when dark, off when daylight
+    - Saves crash and watchdog reports in RTC memory, reported on the next boot
+    - Optional event calendar (.ics) that keeps the lights on during events
 
   Hardware:
     - Adafruit Huzzah ESP8266
@@ -42,6 +44,19 @@ volatile int led_state = 0;
 #include <sunset.h>
 
 #include "config.h" // Configurable parameters
+#include "crash_report.h"
+#ifdef ENABLE_SECURE_TELEMETRY
+#include "secure_telemetry.h"
+#endif
+#ifdef ENABLE_HORIZON_MASK
+#include "horizon.h"
+#endif
+#ifdef ENABLE_GPS
+#include "gps.h"
+#endif
+#ifdef ENABLE_ICS_OVERRIDE
+#include "calendar.h"
+#endif
 
 const char* TZ_STR = TIMEZONE;
 SunSet sun;
@@ -49,6 +64,10 @@ SunSet sun;
 time_t sunset_time;
 time_t sunrise_time;
 
+// Location for sunrise/sunset, updated from GPS if enabled
+double site_latitude = LATITUDE;
+double site_longitude = LONGITUDE;
+
 int current_pwm_duty = 0;
 
 boolean attemptConnect() {
@@ -65,6 +84,19 @@ boolean attemptConnect() {
 
 void fadeToBrightness(int targetBrightness, int stepDelay=20); // Forward declaration
 
+// Wait, but keep reading the GPS so its buffer doesn't overflow
+void waitAndPoll(unsigned long ms) {
+#ifdef ENABLE_GPS
+  unsigned long start = millis();
+  while (millis() - start < ms) {
+    gpsLoop();
+    delay(10);
+  }
+#else
+  delay(ms);
+#endif
+}
+
 #ifdef ENABLE_BUTTON_OVERRIDE
 // Interrupt Service Routine for button press
 void IRAM_ATTR handleButtonPress() {
@@ -90,31 +122,52 @@ void setup() {
   pinMode(BUTTON_PIN, INPUT_PULLUP); // Button, active low
 #endif
   Serial.begin(115200);
+  crashReportSetup();
 
   // Wifi credentials from config.h
   const char* ssid = WIFI_SSID;
   const char* password = WIFI_PASSWORD;
 
+  crashSetStage(STAGE_WIFI);
   WiFi.mode(WIFI_STA);
   delay(500);
   WiFi.begin(ssid, password);
 
   if (!attemptConnect()) {
-    Serial.println("WiFi connect failed. Restarting...");
+#ifdef ENABLE_GPS
+    // GPS can provide the time, keep trying WiFi in the background
+    logRecord("WiFi connect failed. Using GPS time.\n");
+#else
+    logRecord("WiFi connect failed. Restarting...\n");
     ESP.restart();
+#endif
   } else {
-    Serial.println("WiFi Connected.");
-    Serial.print("IP Address: ");
-    Serial.println(WiFi.localIP());
+    logRecord("WiFi Connected.\n");
+    logRecord("IP Address: %s\n", WiFi.localIP().toString().c_str());
   }
 
   configTime(TZ_STR, "pool.ntp.org");
+
+#ifdef ENABLE_GPS
+  gpsSetup();
+#endif
+
+#ifdef ENABLE_SECURE_TELEMETRY
+  telemetrySetup();
+#endif
 }
 
 bool isDark () {
   time_t tnow;
   tnow = time(nullptr);
 
+#ifdef ENABLE_ICS_OVERRIDE
+  // Scheduled events keep the lights on as if it were dark
+  if (calendarOverrideActive(tnow)) {
+    return true;
+  }
+#endif
+
   if (tnow >= sunrise_time && tnow < sunset_time) {
     return false;
   } else {
@@ -124,14 +177,14 @@ bool isDark () {
 
 void fadeToBrightness(int targetBrightness, int stepDelay) {
   if (current_pwm_duty < targetBrightness) {
-    Serial.printf("Fading up\n");
+    logRecord("Fading up\n");
     while (current_pwm_duty <= targetBrightness) {
       analogWrite(LED_MOSFET_PIN, current_pwm_duty);
       delay(stepDelay);
       current_pwm_duty++;
     }
   } else if (current_pwm_duty > targetBrightness) {
-    Serial.printf("Fading down\n");
+    logRecord("Fading down\n");
     while (current_pwm_duty >= targetBrightness) {
       analogWrite(LED_MOSFET_PIN, current_pwm_duty);
       delay(stepDelay);
@@ -144,20 +197,21 @@ void fadeToBrightness(int targetBrightness, int stepDelay) {
  * Use the SunSet library to calculate sunrise and sunset times
  * Calculates "official" sunset, when the center of the sun is
  * 0.833 degrees below the horizon
+ * With ENABLE_HORIZON_MASK, uses the local horizon profile instead
  */
 void calcSunriseSunset() {
   time_t tnow;
   tnow = time(nullptr);
   struct tm *t = localtime(&tnow);
 
-  sun.setPosition(LATITUDE, LONGITUDE, t->tm_isdst ? DST_OFFSET : TZ_OFFSET);
-  Serial.printf("Calculating sunrise/sunset for date %04d-%02d-%02d\n", t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
+  sun.setPosition(site_latitude, site_longitude, t->tm_isdst ? DST_OFFSET : TZ_OFFSET);
+  logRecord("Calculating sunrise/sunset for date %04d-%02d-%02d\n", t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
   sun.setCurrentDate(t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
 
   double sunrise_minutes = sun.calcSunrise();
   double sunset_minutes = sun.calcSunset();
 
-  Serial.printf("Sunrise at %.2f minutes, Sunset at %.2f minutes\n", sunrise_minutes, sunset_minutes);
+  logRecord("Sunrise at %.2f minutes, Sunset at %.2f minutes\n", sunrise_minutes, sunset_minutes);
 
   // Convert those into time_t for today
   struct tm sunriseTm = *t;
@@ -171,19 +225,40 @@ void calcSunriseSunset() {
   sunsetTm.tm_min  = (int) sunset_minutes % 60;
   sunsetTm.tm_sec  = 0;
   sunset_time = mktime(&sunsetTm);
+
+#ifdef ENABLE_HORIZON_MASK
+  // Replace with the times the sun clears the local horizon
+  struct tm midnightTm = *t;
+  midnightTm.tm_hour = 0;
+  midnightTm.tm_min  = 0;
+  midnightTm.tm_sec  = 0;
+  time_t day_start = mktime(&midnightTm);
+
+  time_t local_rise, local_set;
+  if (horizonCrossings(day_start, site_latitude, site_longitude, &local_rise, &local_set)) {
+    logRecord("Local horizon: sun visible for %ld minutes\n", (long) (local_set - local_rise) / 60);
+    sunrise_time = local_rise;
+    sunset_time = local_set;
+  } else {
+    logRecord("Sun stays below local horizon today\n");
+    sunrise_time = day_start;
+    sunset_time = day_start;
+  }
+#endif
 }
 
 void loop() {
 #ifdef ENABLE_BUTTON_OVERRIDE
-  Serial.printf("Override: %s, State: %s\n", led_override ? "ON" : "OFF", led_state ? "ON" : "OFF");
+  logRecord("Override: %s, State: %s\n", led_override ? "ON" : "OFF", led_state ? "ON" : "OFF");
   if (led_override) {
     // Print override state for debug
+    crashSetStage(STAGE_FADE);
     if (!isDark() && !led_state) {
-      Serial.println("LEDs ON (override)");
+      logRecord("LEDs ON (override)\n");
       fadeToBrightness(LED_PWM_DUTY, 20); // Fade to 75% brightness
       led_state = true;
     } else if (isDark() && led_state) {
-      Serial.println("LEDs OFF (override)");
+      logRecord("LEDs OFF (override)\n");
       fadeToBrightness(0, 20); // Fade to 0% brightness
       led_state = false;
     }
@@ -197,40 +272,58 @@ void loop() {
   if (!time_initialized) {
     // Wait until year is at least 2020
     if (t->tm_year + 1900 < 2020) {
-      Serial.println("Waiting for NTP time...");
-      delay(1000);
+      crashSetStage(STAGE_WAIT_NTP);
+      logRecord("Waiting for NTP time...\n");
+      waitAndPoll(1000);
       return;
     }
-    Serial.println("Initial NTP sync succeeded");
+    logRecord("Initial NTP sync succeeded\n");
   }
 
+#ifdef ENABLE_GPS
+  if (gpsPositionMoved(&site_latitude, &site_longitude)) {
+    logRecord("GPS position %.4f, %.4f\n", site_latitude, site_longitude);
+  }
+#endif
+
+  crashSetStage(STAGE_CALC_SUN);
   calcSunriseSunset();
 
   // Print current, sunrise, and sunset times
   char buf[32];
   strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", t);
-  Serial.print("Current time: ");
-  Serial.println(buf);
+  logRecord("Current time: %s\n", buf);
 
   struct tm *sr = localtime(&sunrise_time);
   strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", sr);
-  Serial.print("Sunrise: ");
-  Serial.println(buf);
+  logRecord("Sunrise: %s\n", buf);
 
   struct tm *ss = localtime(&sunset_time);
   strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", ss);
-  Serial.print("Sunset: ");
-  Serial.println(buf);
+  logRecord("Sunset: %s\n", buf);
+
+#ifdef ENABLE_ICS_OVERRIDE
+  crashSetStage(STAGE_CALENDAR);
+  calendarLoop();
+#endif
 
   // Compare
+  crashSetStage(STAGE_FADE);
   bool is_dark = isDark();
   if (is_dark) {
-    Serial.println("It is dark");
+    logRecord("It is dark\n");
     fadeToBrightness(LED_PWM_DUTY, 20); // Fade to 75% brightness
   } else {
-    Serial.println("It is daylight");
+    logRecord("It is daylight\n");
     fadeToBrightness(0, 20); // Fade to 0% brightness
   }
 
-  delay(60000); // update once per minute
+#ifdef ENABLE_SECURE_TELEMETRY
+  // Done after the fade so a slow handshake never stalls it
+  crashSetStage(STAGE_TELEMETRY);
+  telemetryLoop(is_dark, current_pwm_duty, sunrise_time, sunset_time);
+#endif
+
+  crashSetStage(STAGE_IDLE);
+  waitAndPoll(60000); // update once per minute
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "nmea.h"
+#include "time_util.h"
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+static int twoDigits(const char *s) {
+  return (s[0] - '0') * 10 + (s[1] - '0');
+}
+
+static bool allDigits(const char *s, int n) {
+  for (int i = 0; i < n; i++) {
+    if (s[i] < '0' || s[i] > '9') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Convert NMEA "dddmm.mmmm" plus hemisphere to decimal degrees
+static bool parseCoordinate(const char *value, const char *hemisphere, double *out) {
+  if (!value[0] || !hemisphere[0]) {
+    return false;
+  }
+  double raw = strtod(value, nullptr);
+  int degrees = (int) (raw / 100);
+  double result = degrees + (raw - degrees * 100) / 60.0;
+  if (hemisphere[0] == 'S' || hemisphere[0] == 'W') {
+    result = -result;
+  }
+  *out = result;
+  return true;
+}
+
+NmeaParser::NmeaParser() {
+  memset(this, 0, sizeof(*this));
+}
+
+void NmeaParser::reset() {
+  _in_sentence = false;
+  _in_checksum = false;
+  _len = 0;
+}
+
+NmeaSentence NmeaParser::feed(char c) {
+  if (c == '$') {
+    _in_sentence = true;
+    _in_checksum = false;
+    _len = 0;
+    _checksum = 0;
+    return NMEA_NONE;
+  }
+  if (!_in_sentence) {
+    return NMEA_NONE;
+  }
+  if (c == '\r' || c == '\n') {
+    _in_sentence = false;
+    _line[_len] = '\0';
+    return _in_checksum ? parseLine() : NMEA_NONE;
+  }
+  if (_len >= NMEA_MAX_LENGTH) {
+    // Too long, wait for the next '$'
+    _in_sentence = false;
+    return NMEA_NONE;
+  }
+  if (c == '*') {
+    _in_checksum = true;
+  } else if (!_in_checksum) {
+    _checksum ^= c;
+  }
+  _line[_len++] = c;
+  return NMEA_NONE;
+}
+
+NmeaSentence NmeaParser::parseLine() {
+  // Verify "*hh" at the end
+  char *star = strchr(_line, '*');
+  if (!star || hexValue(star[1]) < 0 || hexValue(star[2]) < 0 || star[3] != '\0' ||
+      ((hexValue(star[1]) << 4) | hexValue(star[2])) != _checksum) {
+    _checksum_errors++;
+    return NMEA_NONE;
+  }
+  *star = '\0';
+
+  // Split into fields in place
+  _field_count = 0;
+  char *p = _line;
+  _fields[_field_count++] = p;
+  while ((p = strchr(p, ',')) != nullptr && _field_count < NMEA_MAX_FIELDS) {
+    *p++ = '\0';
+    _fields[_field_count++] = p;
+  }
+
+  // Address is talker (GP, GN, GL...) followed by sentence type
+  const char *address = _fields[0];
+  if (strlen(address) != 5) {
+    return NMEA_NONE;
+  }
+  if (strcmp(address + 2, "RMC") == 0) {
+    return parseRmc() ? NMEA_RMC : NMEA_NONE;
+  }
+  if (strcmp(address + 2, "GGA") == 0) {
+    return parseGga() ? NMEA_GGA : NMEA_NONE;
+  }
+  return NMEA_NONE;
+}
+
+/*
+ * $--RMC,hhmmss.ss,A,llll.ll,a,yyyyy.yy,a,x.x,x.x,ddmmyy,x.x,a*hh
+ */
+bool NmeaParser::parseRmc() {
+  if (_field_count < 10) {
+    return false;
+  }
+  const char *time = _fields[1];
+  const char *status = _fields[2];
+  const char *date = _fields[9];
+
+  _fix.time_valid = false;
+  _fix.position_valid = false;
+  if (strlen(time) >= 6 && allDigits(time, 6) && strlen(date) == 6 && allDigits(date, 6)) {
+    int day = twoDigits(date), month = twoDigits(date + 2), year = 2000 + twoDigits(date + 4);
+    _fix.utc = makeUtcTime(year, month, day, twoDigits(time), twoDigits(time + 2), twoDigits(time + 4));
+    _fix.centiseconds = 0;
+    if (time[6] == '.' && time[7] >= '0' && time[7] <= '9') {
+      _fix.centiseconds = (time[7] - '0') * 10;
+      if (time[8] >= '0' && time[8] <= '9') {
+        _fix.centiseconds += time[8] - '0';
+      }
+    }
+    _fix.time_valid = true;
+  }
+  if (status[0] == 'A') {
+    _fix.position_valid = parseCoordinate(_fields[3], _fields[4], &_fix.latitude) &&
+                          parseCoordinate(_fields[5], _fields[6], &_fix.longitude);
+  }
+  return true;
+}
+
+/*
+ * $--GGA,hhmmss.ss,llll.ll,a,yyyyy.yy,a,q,nn,x.x,x.x,M,x.x,M,x.x,xxxx*hh
+ */
+bool NmeaParser::parseGga() {
+  if (_field_count < 8) {
+    return false;
+  }
+  _fix.quality = (uint8_t) atoi(_fields[6]);
+  _fix.satellites = (uint8_t) atoi(_fields[7]);
+  return true;
+}
@@ -0,0 +1,65 @@
+/*
+ * Incremental NMEA 0183 parser
+ *
+ * Characters are fed one at a time as they arrive from the GPS. Only RMC
+ * (time, date and position) and GGA (fix quality and satellites) sentences
+ * are decoded. Uses a fixed line buffer and never allocates, and has no
+ * Arduino dependencies so it can be run on a host.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#define NMEA_MAX_LENGTH 82 // Including $ and checksum, excluding CR LF
+#define NMEA_MAX_FIELDS 20
+
+enum NmeaSentence {
+  NMEA_NONE,
+  NMEA_RMC,
+  NMEA_GGA,
+};
+
+struct NmeaFix {
+  // From RMC
+  bool time_valid;
+  time_t utc;           // Seconds since epoch, UTC
+  uint16_t centiseconds;
+  bool position_valid;
+  double latitude;      // Decimal degrees, negative is south
+  double longitude;     // Decimal degrees, negative is west
+
+  // From GGA
+  uint8_t quality;      // 0 = no fix
+  uint8_t satellites;
+};
+
+class NmeaParser {
+public:
+  NmeaParser();
+
+  // Feed one character. Returns the sentence type when a sentence with a
+  // valid checksum has been decoded, otherwise NMEA_NONE.
+  NmeaSentence feed(char c);
+
+  // Drop any partly received sentence, e.g. after discarding buffered input
+  void reset();
+
+  const NmeaFix &fix() const { return _fix; }
+  uint32_t checksumErrors() const { return _checksum_errors; }
+
+private:
+  NmeaSentence parseLine();
+  bool parseRmc();
+  bool parseGga();
+
+  char _line[NMEA_MAX_LENGTH + 1];
+  uint8_t _len;
+  uint8_t _checksum;
+  bool _in_sentence;
+  bool _in_checksum;
+  char *_fields[NMEA_MAX_FIELDS];
+  uint8_t _field_count;
+  NmeaFix _fix;
+  uint32_t _checksum_errors;
+};
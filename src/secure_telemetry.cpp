@@ -0,0 +1,192 @@
+#ifdef ENABLE_SECURE_TELEMETRY
+#include <Arduino.h>
+
+#include <ESP8266WiFi.h>
+#include <WiFiClientSecureBearSSL.h>
+#include <LittleFS.h>
+#include <StackThunk.h>
+#ifdef UMM_STATS_FULL
+#include <umm_malloc/umm_malloc_cfg.h>
+#endif
+
+#include "config.h"
+#include "crash_report.h"
+#include "secure_telemetry.h"
+
+#define TLS_SESSION_FILE "/tls_session.bin"
+
+/*
+ * Cipher suites we offer, cheapest first. RSA key exchange only needs a
+ * public key operation on our side, which is much faster on the ESP8266
+ * than ECDHE. Keep at least one ECDHE suite for servers that require it.
+ */
+static const uint16_t tls_ciphers[] = {
+  BR_TLS_RSA_WITH_AES_128_GCM_SHA256,
+  BR_TLS_RSA_WITH_AES_128_CBC_SHA256,
+  BR_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+  BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+};
+
+static BearSSL::Session tls_session;
+static bool mfln_checked = false;
+static bool mfln_supported = false;
+static unsigned long last_sent = 0;
+static bool sent_once = false;
+
+/*
+ * Handshake statistics, kept separately for full and resumed handshakes.
+ * "Held" is the heap still allocated once connect() returns. The peak during
+ * the handshake needs the heap's low-water counter, which the core only
+ * keeps when built with -DUMM_STATS_FULL. BearSSL runs on its own stack
+ * (the stack thunk), whose high-water mark is tracked separately.
+ */
+struct HandshakeStats {
+  unsigned long count;
+  unsigned long total_ms;
+  uint32_t max_heap_held;
+  uint32_t max_heap_peak;
+  uint32_t max_thunk_stack;
+};
+
+static HandshakeStats full_stats = {};
+static HandshakeStats resumed_stats = {};
+
+static void formatPeak(char *buf, size_t len, uint32_t peak) {
+#ifdef UMM_STATS_FULL
+  snprintf(buf, len, "%u", peak);
+#else
+  (void) peak;
+  snprintf(buf, len, "n/a");
+#endif
+}
+
+/*
+ * BearSSL::Session only holds a br_ssl_session_parameters struct,
+ * so its raw bytes can be stored and restored directly.
+ */
+static void loadSession() {
+  File f = LittleFS.open(TLS_SESSION_FILE, "r");
+  if (!f) {
+    logRecord("No saved TLS session\n");
+    return;
+  }
+  if (f.size() == sizeof(tls_session)) {
+    f.read((uint8_t *) &tls_session, sizeof(tls_session));
+    logRecord("Loaded saved TLS session\n");
+  }
+  f.close();
+}
+
+static void saveSession() {
+  File f = LittleFS.open(TLS_SESSION_FILE, "w");
+  if (!f) {
+    logRecord("Unable to save TLS session\n");
+    return;
+  }
+  f.write((const uint8_t *) &tls_session, sizeof(tls_session));
+  f.close();
+}
+
+void telemetrySetup() {
+  if (!LittleFS.begin()) {
+    logRecord("LittleFS mount failed, TLS session will not persist\n");
+    return;
+  }
+  loadSession();
+}
+
+static bool sendTelemetry(bool is_dark, int pwm_duty, time_t sunrise, time_t sunset) {
+  // Find out once whether the server will accept smaller TLS records
+  if (!mfln_checked) {
+    mfln_supported = BearSSL::WiFiClientSecure::probeMaxFragmentLength(TELEMETRY_HOST, TELEMETRY_PORT, TLS_RX_BUFFER_SIZE);
+    mfln_checked = true;
+    logRecord("TLS max fragment length %u: %s\n", TLS_RX_BUFFER_SIZE, mfln_supported ? "supported" : "not supported");
+  }
+
+  BearSSL::WiFiClientSecure client;
+  client.setFingerprint(TELEMETRY_FINGERPRINT);
+  client.setCiphers(tls_ciphers, sizeof(tls_ciphers) / sizeof(tls_ciphers[0]));
+  if (mfln_supported) {
+    client.setBufferSizes(TLS_RX_BUFFER_SIZE, TLS_TX_BUFFER_SIZE);
+  }
+  client.setSession(&tls_session);
+
+  // If the session parameters are unchanged after connecting, the server resumed it
+  uint8_t before[sizeof(tls_session)];
+  memcpy(before, &tls_session, sizeof(tls_session));
+
+  uint32_t heap_before = ESP.getFreeHeap();
+#ifdef UMM_STATS_FULL
+  umm_free_heap_size_min_reset();
+#endif
+  unsigned long start = millis();
+  if (!client.connect(TELEMETRY_HOST, TELEMETRY_PORT)) {
+    logRecord("TLS connect to %s:%d failed\n", TELEMETRY_HOST, TELEMETRY_PORT);
+    return false;
+  }
+  unsigned long elapsed = millis() - start;
+  uint32_t heap_after = ESP.getFreeHeap();
+  uint32_t heap_held = heap_before > heap_after ? heap_before - heap_after : 0;
+  uint32_t heap_peak = 0;
+#ifdef UMM_STATS_FULL
+  uint32_t heap_min = umm_free_heap_size_min();
+  heap_peak = heap_before > heap_min ? heap_before - heap_min : 0;
+#endif
+  // Read while the client is alive, the thunk stack is freed with the last client
+  uint32_t thunk_stack = stack_thunk_get_max_usage();
+
+  bool resumed = memcmp(before, &tls_session, sizeof(tls_session)) == 0;
+  HandshakeStats &stats = resumed ? resumed_stats : full_stats;
+  stats.count++;
+  stats.total_ms += elapsed;
+  if (heap_held > stats.max_heap_held) {
+    stats.max_heap_held = heap_held;
+  }
+  if (heap_peak > stats.max_heap_peak) {
+    stats.max_heap_peak = heap_peak;
+  }
+  if (thunk_stack > stats.max_thunk_stack) {
+    stats.max_thunk_stack = thunk_stack;
+  }
+  if (!resumed) {
+    saveSession();
+  }
+
+  char peak[12], full_peak[12], resumed_peak[12];
+  formatPeak(peak, sizeof(peak), heap_peak);
+  formatPeak(full_peak, sizeof(full_peak), full_stats.max_heap_peak);
+  formatPeak(resumed_peak, sizeof(resumed_peak), resumed_stats.max_heap_peak);
+  logRecord("TLS %s handshake: %lu ms, heap peak %s, held %u (free %u), BearSSL stack %u\n",
+            resumed ? "resumed" : "full", elapsed, peak, heap_held, heap_after, thunk_stack);
+  logRecord("TLS full: %lu (avg %lu ms, max heap peak %s, held %u, stack %u)\n",
+            full_stats.count, full_stats.count ? full_stats.total_ms / full_stats.count : 0,
+            full_peak, full_stats.max_heap_held, full_stats.max_thunk_stack);
+  logRecord("TLS resumed: %lu (avg %lu ms, max heap peak %s, held %u, stack %u)\n",
+            resumed_stats.count, resumed_stats.count ? resumed_stats.total_ms / resumed_stats.count : 0,
+            resumed_peak, resumed_stats.max_heap_held, resumed_stats.max_thunk_stack);
+
+  client.printf("GET %s?dark=%d&pwm=%d&sunrise=%ld&sunset=%ld HTTP/1.1\r\n"
+                "Host: %s\r\n"
+                "Connection: close\r\n\r\n",
+                TELEMETRY_PATH, is_dark ? 1 : 0, pwm_duty, (long) sunrise, (long) sunset, TELEMETRY_HOST);
+
+  // Only the status line is of interest
+  String status = client.readStringUntil('\n');
+  status.trim();
+  logRecord("Telemetry response: %s\n", status.c_str());
+  client.stop();
+  return true;
+}
+
+void telemetryLoop(bool is_dark, int pwm_duty, time_t sunrise, time_t sunset) {
+  if (WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  if (sent_once && millis() - last_sent < TELEMETRY_INTERVAL_MIN * 60000UL) {
+    return;
+  }
+  last_sent = millis();
+  sent_once = true;
+  sendTelemetry(is_dark, pwm_duty, sunrise, sunset);
+}
+#endif
@@ -0,0 +1,13 @@
+/*
+ * Secure telemetry over TLS (BearSSL)
+ *
+ * Periodically reports the controller state to an HTTPS endpoint.
+ * The TLS session is persisted to LittleFS so that after a reboot the
+ * next connection can resume it instead of doing a full handshake.
+ */
+#pragma once
+
+#include <time.h>
+
+void telemetrySetup();
+void telemetryLoop(bool is_dark, int pwm_duty, time_t sunrise, time_t sunset);
@@ -0,0 +1,20 @@
+/*
+ * Time helpers shared by the parsers
+ */
+#pragma once
+
+#include <time.h>
+
+/*
+ * Seconds since epoch for a UTC date and time (proleptic Gregorian),
+ * the C library has no timegm() on this platform.
+ */
+inline time_t makeUtcTime(int year, int month, int day, int hour, int min, int sec) {
+  int y = year - (month <= 2);
+  long era = (y >= 0 ? y : y - 399) / 400;
+  long yoe = y - era * 400;
+  long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  long days = era * 146097 + doe - 719468;
+  return (time_t) days * 86400 + hour * 3600 + min * 60 + sec;
+}
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""
+Decode a Dusk to Dawn crash report.
+
+Reads a crash report (serial log or the /crash.log journal) and resolves
+the code addresses against the firmware ELF built by `pio run -e huzzah`.
+
+Usage:
+    tools/decode_crash.py crash.log
+    pio device monitor | tools/decode_crash.py    (decodes as lines arrive, stop with Ctrl-C)
+"""
+
+import argparse
+import glob
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+DEFAULT_ELF = ".pio/build/huzzah/firmware.elf"
+
+EXCEPTION_CAUSES = {
+    0: "IllegalInstruction",
+    2: "InstructionFetchError",
+    3: "LoadStoreError",
+    4: "Level1Interrupt",
+    5: "Alloca",
+    6: "IntegerDivideByZero",
+    8: "Privileged",
+    9: "LoadStoreAlignment",
+    12: "InstrPIFDataError",
+    13: "LoadStorePIFDataError",
+    14: "InstrPIFAddrError",
+    15: "LoadStorePIFAddrError",
+    16: "InstTLBMiss",
+    17: "InstTLBMultiHit",
+    18: "InstFetchPrivilege",
+    20: "InstFetchProhibited",
+    24: "LoadStoreTLBMiss",
+    25: "LoadStoreTLBMultiHit",
+    26: "LoadStorePrivilege",
+    28: "LoadProhibited",
+    29: "StoreProhibited",
+}
+
+ADDRESS_RE = re.compile(r"0x(40[12][0-9a-fA-F]{5})")
+EXCEPTION_RE = re.compile(r"Exception (\d+)")
+
+
+def find_addr2line():
+    tool = shutil.which("xtensa-lx106-elf-addr2line")
+    if tool:
+        return tool
+    pattern = os.path.expanduser("~/.platformio/packages/toolchain-xtensa*/bin/xtensa-lx106-elf-addr2line*")
+    matches = glob.glob(pattern)
+    if matches:
+        return matches[0]
+    sys.exit("xtensa-lx106-elf-addr2line not found, install the PlatformIO espressif8266 platform")
+
+
+def symbolise(addr2line, elf, addresses):
+    """Return a dict of address -> 'function at file:line'."""
+    if not addresses:
+        return {}
+    out = subprocess.run([addr2line, "-pfiaC", "-e", elf] + addresses,
+                         check=True, capture_output=True, text=True).stdout
+    result = {}
+    current = None
+    for line in out.splitlines():
+        m = re.match(r"0x0*([0-9a-f]+): (.*)", line)
+        if m:
+            current = "0x" + m.group(1).rjust(8, "0")
+            result[current] = m.group(2)
+        elif current and line.strip():
+            # Inlined frames follow on their own lines
+            result[current] += "\n" + " " * 14 + line.strip()
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("report", nargs="?", help="crash report file, default is stdin")
+    parser.add_argument("-e", "--elf", default=DEFAULT_ELF, help="firmware ELF (default: %(default)s)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.elf):
+        sys.exit("%s not found, run `pio run -e huzzah` first" % args.elf)
+
+    # Decode line by line so a live serial monitor can be piped in.
+    # Addresses are cached since the same ones repeat across reports.
+    addr2line = find_addr2line()
+    symbols = {}
+    stream = open(args.report) if args.report else sys.stdin
+    try:
+        for line in stream:
+            line = line.rstrip("\r\n")
+            print(line)
+            m = EXCEPTION_RE.search(line)
+            if m and int(m.group(1)) in EXCEPTION_CAUSES:
+                print("    cause: %s" % EXCEPTION_CAUSES[int(m.group(1))])
+            addresses = ["0x" + a.lower() for a in ADDRESS_RE.findall(line)]
+            missing = sorted({a for a in addresses if a not in symbols})
+            symbols.update(symbolise(addr2line, args.elf, missing))
+            for addr in addresses:
+                print("    %s: %s" % (addr, symbols.get(addr, "??")))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == "__main__":
+    main()
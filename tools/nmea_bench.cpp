@@ -0,0 +1,65 @@
+/*
+ * Host benchmark for the NMEA parser
+ *
+ * Feeds a recorded NMEA stream through NmeaParser repeatedly and reports
+ * parser throughput and cost per byte.
+ *
+ * Build and run from the repository root:
+ *   g++ -O2 -Isrc tools/nmea_bench.cpp src/nmea.cpp -o nmea_bench
+ *   ./nmea_bench tools/sample.nmea
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "nmea.h"
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s stream.nmea [iterations]\n", argv[0]);
+    return 1;
+  }
+  int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+
+  FILE *f = fopen(argv[1], "rb");
+  if (!f) {
+    perror(argv[1]);
+    return 1;
+  }
+  std::vector<char> data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(f);
+
+  size_t sentences = 0, rmc = 0, gga = 0;
+  for (char c : data) {
+    sentences += c == '$';
+  }
+
+  NmeaParser parser;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    for (char c : data) {
+      switch (parser.feed(c)) {
+        case NMEA_RMC: rmc++; break;
+        case NMEA_GGA: gga++; break;
+        default: break;
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double total_bytes = (double) data.size() * iterations;
+  double total_sentences = (double) sentences * iterations;
+  printf("%zu bytes, %zu sentences, %d iterations\n", data.size(), sentences, iterations);
+  printf("decoded per pass: %zu RMC, %zu GGA, %u checksum errors total\n",
+         rmc / iterations, gga / iterations, parser.checksumErrors());
+  printf("%.0f sentences/s, %.1f MB/s, %.2f ns/byte\n",
+         total_sentences / seconds, total_bytes / seconds / 1e6, seconds * 1e9 / total_bytes);
+  return 0;
+}